@@ -6,6 +6,17 @@
 #include <string.h>
 #include <time.h>
 #include <algorithm>
+#include <vector>
+
+// POSIX共享内存，用于跨进程共享置换表
+#if !defined(_WIN32)
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+    #define HAVE_SHARED_TRANS_TABLE
+#endif
 
 #include "2048.h"
 
@@ -273,6 +284,15 @@ static inline board_t execute_move_3(board_t board) {
     return ret;
 }
 
+// 对单独一行(或转置后的一列)执行移动，用于增量更新
+// 向上/向左共用row_left_table，向下/向右共用row_right_table：
+// 对转置棋盘的行做左移等价于对原棋盘的列做上移，与col_up_table/col_down_table结果一致
+static inline row_t execute_move_line(int move, row_t line) {
+    if (move == 0 || move == 2)
+        return line ^ row_left_table[line];
+    return line ^ row_right_table[line];
+}
+
 /* 执行指定方向的移动 */
 board_t execute_move(int move, board_t board) {
     switch(move) {
@@ -342,19 +362,333 @@ static inline int count_distinct_tiles(board_t board) {
  * f. 选择得分最高的移动方向
  */
 
+/**
+ * 跨进程共享置换表
+ * -------------
+ * eval_state中的私有置换表在每次评估后即被销毁。同一台机器上运行多个引擎进程时，
+ * 可以额外挂载一个命名的POSIX共享内存段(位于/dev/shm)，所有进程共享其中的评估结果。
+ *
+ * - 条目固定为16字节：check = board ^ data，读取时校验 check ^ data == board，
+ *   因此无需加锁，被并发写入撕裂的条目只会校验失败而被当作未命中
+ * - data中打包了评分(float)、剩余搜索深度、写入时间(秒，取低8位)和到达概率分桶；
+ *   只有深度不浅于、且概率剪枝不比当前查询更激进的条目才会命中
+ * - 每个桶两个条目，优先替换同一棋盘、过期(超过SHARED_TRANS_STALE_SECS秒)或剩余深度更浅的条目
+ * - 只有剩余深度不少于SHARED_TRANS_MIN_REMAINING的随机节点才查询和写入共享表：
+ *   浅层子树重新计算比访问共享内存(通常不在缓存中)更便宜，写入它们只会挤占条目
+ * - 段头记录条目格式版本和启发式评分表的指纹，与当前进程不一致时拒绝挂载，
+ *   避免不同版本或不同权重的引擎读到彼此的评分
+ * - 不持有任何锁或引用计数，进程在挂载期间崩溃不会影响其他进程；
+ *   若创建者在初始化完成前崩溃，后续进程等待超时后删除该段并重新创建
+ */
+struct shared_trans_entry_t {
+    uint64_t check; // board ^ data
+    uint64_t data;  // 评分 | 剩余深度 << 32 | 时间 << 40 | 标记 << 48 | 概率分桶 << 56
+};
+
+struct shared_trans_header_t {
+    uint64_t magic;       // 初始化完成后最后写入
+    uint64_t num_entries; // 条目数量，2的幂
+    uint64_t version;     // 条目格式版本，即SHARED_TRANS_VERSION
+    uint64_t fingerprint; // 创建者的heur_score_table指纹
+    uint64_t reserved[4]; // 填充到64字节，使条目按缓存行对齐
+};
+
+static const uint64_t SHARED_TRANS_MAGIC = 0x3834303254524e53ULL; // "SNRT2048"
+static const uint64_t SHARED_TRANS_VERSION = 2;                   // 修改条目编码或评分含义时递增
+static const uint64_t SHARED_TRANS_TAG = 0x48;                    // 区分有效条目与全零的初始内存
+static const unsigned SHARED_TRANS_STALE_SECS = 4;                // 超过此时间的条目优先被替换
+static const unsigned SHARED_TRANS_DEFAULT_MB = 256;              // 新建共享内存段的默认大小
+static const int SHARED_TRANS_MIN_REMAINING = 3;                  // 只共享剩余深度不少于此值的子树
+
+static inline uint8_t shared_trans_age() {
+    return (uint8_t)time(NULL);
+}
+
+#if defined(HAVE_SHARED_TRANS_TABLE)
+
+static shared_trans_header_t *shared_trans_header = NULL;
+static shared_trans_entry_t *shared_trans_entries = NULL;
+static size_t shared_trans_bytes = 0;
+
+// 启发式评分表的FNV-1a哈希，任何权重或评分公式的改动都会改变它
+// 必须在init_tables之后调用
+static uint64_t shared_trans_fingerprint() {
+    const unsigned char *bytes = (const unsigned char *)heur_score_table;
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < sizeof(heur_score_table); ++i) {
+        h ^= bytes[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static inline shared_trans_entry_t *shared_trans_bucket(board_t board) {
+    uint64_t h = board * 0x9E3779B97F4A7C15ULL;
+    h ^= h >> 32;
+    return &shared_trans_entries[h & (shared_trans_header->num_entries - 1) & ~1ULL];
+}
+
+// 到达概率的粗略分桶，约为-log2(cprob)，0表示cprob为1
+// 写入时向上取整(条目的cprob >= 2^-桶)，查询时向下取整(请求的cprob <= 2^-桶)，
+// 因此条目的桶不大于查询的桶时，条目一定是在不低于请求概率的条件下搜索的
+static inline int shared_trans_cprob_bucket(float cprob, bool round_up) {
+    int e;
+    float m = frexpf(cprob, &e); // cprob = m * 2^e, 0.5 <= m < 1
+    int bucket = (round_up || m == 0.5f) ? 1 - e : -e;
+    return std::min(255, std::max(0, bucket));
+}
+
+// 从共享置换表中查找至少搜索了remaining层、且概率剪枝不比cprob更激进的评分
+static bool shared_trans_lookup(board_t board, int remaining, float cprob, float &heuristic) {
+    if (!shared_trans_header)
+        return false;
+
+    shared_trans_entry_t *bucket = shared_trans_bucket(board);
+    for (int i = 0; i < 2; ++i) {
+        uint64_t check = __atomic_load_n(&bucket[i].check, __ATOMIC_RELAXED);
+        uint64_t data  = __atomic_load_n(&bucket[i].data,  __ATOMIC_RELAXED);
+        if ((check ^ data) != board || ((data >> 48) & 0xff) != SHARED_TRANS_TAG)
+            continue;
+        if (int((data >> 32) & 0xff) < remaining ||
+            int(data >> 56) > shared_trans_cprob_bucket(cprob, false))
+            return false;
+        uint32_t bits = (uint32_t)data;
+        memcpy(&heuristic, &bits, sizeof(heuristic));
+        return true;
+    }
+    return false;
+}
+
+// 将以到达概率cprob搜索了remaining层的评分写入共享置换表
+static void shared_trans_store(board_t board, int remaining, float cprob, float heuristic, uint8_t age) {
+    if (!shared_trans_header)
+        return;
+
+    int cprob_bucket = shared_trans_cprob_bucket(cprob, true);
+    shared_trans_entry_t *bucket = shared_trans_bucket(board);
+    int victim = -1;
+    int victim_prio = 0;
+    for (int i = 0; i < 2; ++i) {
+        uint64_t check = __atomic_load_n(&bucket[i].check, __ATOMIC_RELAXED);
+        uint64_t data  = __atomic_load_n(&bucket[i].data,  __ATOMIC_RELAXED);
+        int depth = int((data >> 32) & 0xff);
+        bool stale = ((data >> 48) & 0xff) != SHARED_TRANS_TAG ||
+                     uint8_t(age - uint8_t(data >> 40)) >= SHARED_TRANS_STALE_SECS;
+        if ((check ^ data) == board && !stale) {
+            // 同一棋盘：已有条目搜索得同样深且概率不低时保留
+            if (depth >= remaining && int(data >> 56) <= cprob_bucket)
+                return;
+            victim = i;
+            victim_prio = -1;
+            break;
+        }
+        // 过期条目优先替换，其次是剩余深度较浅的条目
+        int prio = stale ? -1 : depth;
+        if (victim < 0 || prio < victim_prio) {
+            victim = i;
+            victim_prio = prio;
+        }
+    }
+    if (victim_prio > remaining)
+        return;
+
+    uint32_t bits;
+    memcpy(&bits, &heuristic, sizeof(bits));
+    uint64_t data = bits | (uint64_t(remaining & 0xff) << 32) | (uint64_t(age) << 40) |
+                    (SHARED_TRANS_TAG << 48) | (uint64_t(cprob_bucket) << 56);
+    __atomic_store_n(&bucket[victim].data,  data,         __ATOMIC_RELAXED);
+    __atomic_store_n(&bucket[victim].check, board ^ data, __ATOMIC_RELAXED);
+}
+
+void detach_shared_trans_table() {
+    if (shared_trans_header)
+        munmap(shared_trans_header, shared_trans_bytes);
+    shared_trans_header = NULL;
+    shared_trans_entries = NULL;
+    shared_trans_bytes = 0;
+}
+
+// 删除创建者未能完成初始化的共享内存段
+// 仅当该名字仍指向fd对应的段时才删除，避免误删其他进程刚重新创建的段
+static void shared_trans_unlink_stale(const char *name, int fd) {
+    int cur_fd = shm_open(name, O_RDWR, 0);
+    if (cur_fd < 0)
+        return;
+    struct stat mine, cur;
+    if (fstat(fd, &mine) == 0 && fstat(cur_fd, &cur) == 0 &&
+        mine.st_dev == cur.st_dev && mine.st_ino == cur.st_ino)
+        shm_unlink(name);
+    close(cur_fd);
+}
+
+// 创建或打开共享内存段并等待其初始化完成
+// 若创建者在初始化完成前崩溃，删除该段并将stale置为true，调用者可重试
+// 已有段的格式版本或启发式指纹与fingerprint不一致时返回NULL
+static shared_trans_header_t *shared_trans_map(const char *name, uint64_t num_entries, uint64_t fingerprint,
+                                               size_t &bytes, bool &stale) {
+    stale = false;
+    bytes = sizeof(shared_trans_header_t) + num_entries * sizeof(shared_trans_entry_t);
+
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0666);
+    bool creator = (fd >= 0);
+    if (creator) {
+        if (ftruncate(fd, bytes) != 0) {
+            close(fd);
+            shm_unlink(name);
+            return NULL;
+        }
+    } else {
+        if (errno != EEXIST)
+            return NULL;
+        fd = shm_open(name, O_RDWR, 0);
+        if (fd < 0)
+            return NULL;
+        // 已存在的共享内存段：使用其自身的大小，等待创建者完成初始化
+        struct stat st;
+        bytes = 0;
+        for (int tries = 0; tries < 100; ++tries) {
+            if (fstat(fd, &st) == 0 && (size_t)st.st_size > sizeof(shared_trans_header_t)) {
+                bytes = st.st_size;
+                break;
+            }
+            usleep(10000);
+        }
+        if (!bytes) {
+            shared_trans_unlink_stale(name, fd);
+            stale = true;
+            close(fd);
+            return NULL;
+        }
+    }
+
+    void *mem = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mem == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+
+    shared_trans_header_t *header = (shared_trans_header_t *)mem;
+    if (creator) {
+        header->num_entries = num_entries;
+        header->version = SHARED_TRANS_VERSION;
+        header->fingerprint = fingerprint;
+        __atomic_store_n(&header->magic, SHARED_TRANS_MAGIC, __ATOMIC_RELEASE);
+    } else {
+        int tries;
+        for (tries = 0; tries < 100; ++tries) {
+            if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) == SHARED_TRANS_MAGIC)
+                break;
+            usleep(10000);
+        }
+        if (tries == 100) {
+            shared_trans_unlink_stale(name, fd);
+            stale = true;
+            munmap(mem, bytes);
+            close(fd);
+            return NULL;
+        }
+        num_entries = header->num_entries;
+        if (header->version != SHARED_TRANS_VERSION || header->fingerprint != fingerprint ||
+            num_entries < 2 || (num_entries & (num_entries - 1)) ||
+            sizeof(shared_trans_header_t) + num_entries * sizeof(shared_trans_entry_t) > bytes) {
+            munmap(mem, bytes);
+            close(fd);
+            return NULL;
+        }
+    }
+
+    close(fd);
+    return header;
+}
+
+int attach_shared_trans_table(const char *name, unsigned size_mb) {
+    detach_shared_trans_table();
+
+    // 条目数量取不超过size_mb的最大2的幂
+    uint64_t num_entries = 2;
+    while (num_entries * 2 * sizeof(shared_trans_entry_t) <= (uint64_t)size_mb << 20)
+        num_entries *= 2;
+
+    size_t bytes;
+    bool stale;
+    uint64_t fingerprint = shared_trans_fingerprint();
+    shared_trans_header_t *header = shared_trans_map(name, num_entries, fingerprint, bytes, stale);
+    if (!header && stale) // 未初始化的段已被删除，重新创建一次
+        header = shared_trans_map(name, num_entries, fingerprint, bytes, stale);
+    if (!header)
+        return -1;
+
+    shared_trans_header = header;
+    shared_trans_entries = (shared_trans_entry_t *)(header + 1);
+    shared_trans_bytes = bytes;
+    return 0;
+}
+
+#else
+
+static bool shared_trans_lookup(board_t, int, float, float &) {
+    return false;
+}
+
+static void shared_trans_store(board_t, int, float, float, uint8_t) {
+}
+
+void detach_shared_trans_table() {
+}
+
+int attach_shared_trans_table(const char *, unsigned) {
+    return -1;
+}
+
+#endif
+
 // 评估状态结构体，用于存储搜索过程中的状态信息
 struct eval_state {
     trans_table_t trans_table; // 置换表，缓存之前看到的移动
     int maxdepth;              // 最大搜索深度
     int curdepth;              // 当前搜索深度
     int cachehits;             // 缓存命中次数
+    int sharedhits;            // 共享置换表命中次数
     unsigned long moves_evaled; // 评估的移动次数
     int depth_limit;           // 深度限制
-
-    eval_state() : maxdepth(0), curdepth(0), cachehits(0), moves_evaled(0), depth_limit(0) {
+    uint8_t shared_age;        // 本次评估写入共享置换表的时间
+    int sampled_nodes;         // 使用抽样近似的随机节点数
+    float node_var;            // 刚返回的节点评分因抽样产生的方差，由调用者通过take_node_var取走
+    bool approximate;          // 本次评估启用了抽样，结果不写入共享置换表
+
+    eval_state() : maxdepth(0), curdepth(0), cachehits(0), sharedhits(0), moves_evaled(0), depth_limit(0),
+                   shared_age(shared_trans_age()), sampled_nodes(0), node_var(0.0f),
+                   approximate(false) {
     }
 };
 
+// 取走刚返回的子节点的方差；叶子节点不设置方差，因此保持为0
+static inline float take_node_var(eval_state &state) {
+    float var = state.node_var;
+    state.node_var = 0.0f;
+    return var;
+}
+
+// 置换表中的方差只保留float的高16位，足够用于误差估计且不增大条目
+static inline uint16_t pack_node_var(float var) {
+    uint32_t bits;
+    memcpy(&bits, &var, sizeof(bits));
+    return (uint16_t)(bits >> 16);
+}
+
+static inline float unpack_node_var(uint16_t packed) {
+    uint32_t bits = (uint32_t)packed << 16;
+    float var;
+    memcpy(&var, &bits, sizeof(var));
+    return var;
+}
+
+// 将节点评分及其方差写入私有置换表
+static inline void trans_table_store(eval_state &state, board_t board, float res, float var) {
+    trans_table_entry_t entry = {static_cast<uint8_t>(state.curdepth), pack_node_var(var), res};
+    state.trans_table[board] = entry;
+}
+
 // 使用启发式函数评估单个棋盘状态
 static float score_heur_board(board_t board);
 // 实际评分单个棋盘状态(包括从生成的4方块获得的分数)
@@ -391,6 +725,187 @@ static float score_board(board_t board) {
 // 不要递归到累积概率小于此阈值的节点
 static const float CPROB_THRESH_BASE = 0.0001f; //, 基础概率阈值，低于此值的节点将不再搜索
 static const int CACHE_DEPTH_LIMIT  = 15;       // 缓存深度限制，控制置换表的使用深度
+static const int SAMPLE_MAX_DEPTH   = 16;       // 可单独设置抽样预算的最大深度
+
+// 各层随机节点最多展开的空格数，0表示完全展开(默认)
+// 通常浅层保持完全展开，只在较深的随机节点上抽样
+static int sample_budget[SAMPLE_MAX_DEPTH];
+
+// 至少抽样2个空格，否则无法估计方差，误差会被低估为0
+void set_sample_budget(int depth, int cells) {
+    if (depth >= 0 && depth < SAMPLE_MAX_DEPTH)
+        sample_budget[depth] = cells <= 0 ? 0 : std::max(2, cells);
+}
+
+// 是否有任何深度启用了抽样
+static bool sample_budget_active() {
+    for (int depth = 0; depth < SAMPLE_MAX_DEPTH; ++depth) {
+        if (sample_budget[depth])
+            return true;
+    }
+    return false;
+}
+
+/* 增量启发式评估
+ * 随机节点的每个子节点与父棋盘只相差一个新生成的方块，即只有一行和一列发生变化。
+ * 因此在最后一层可以先计算一次父棋盘向四个方向移动后的棋盘及其每行、每列的启发式评分，
+ * 子节点的每个移动只需重新移动变化的那一行(或列)，再替换受影响的评分条目，
+ * 而无需为每个叶子做完整的移动、转置和8次查表。
+ * 求和顺序与score_heur_board一致，结果逐位相同。
+ */
+struct heur_lines_t {
+    board_t rows;  // 棋盘本身，每16位为一行
+    board_t cols;  // 转置后的棋盘，每16位为原棋盘的一列
+    float row[4];  // 每行的启发式评分
+    float col[4];  // 每列的启发式评分
+};
+
+// 随机节点的父棋盘信息，仅在第一次遇到叶子层子节点时计算
+struct spawn_parent_t {
+    board_t board;         // 父棋盘
+    board_t trans;         // 转置后的父棋盘
+    bool ready;            // 下面的增量信息是否已计算
+    heur_lines_t moved[4]; // 父棋盘向四个方向移动后的行/列评分
+};
+
+static inline void init_heur_lines(heur_lines_t &h, board_t board) {
+    h.rows = board;
+    h.cols = transpose(board);
+    for (int i = 0; i < 4; ++i) {
+        h.row[i] = heur_score_table[(h.rows >> (16*i)) & ROW_MASK];
+        h.col[i] = heur_score_table[(h.cols >> (16*i)) & ROW_MASK];
+    }
+}
+
+static void init_spawn_parent(spawn_parent_t &p) {
+    p.trans = transpose(p.board);
+    for (int move = 0; move < 4; ++move)
+        init_heur_lines(p.moved[move], execute_move(move, p.board));
+    p.ready = true;
+}
+
+// 子节点向move方向移动后的启发式评分，移动无效时返回0
+// 左右移动只改变第idx(=行号)行；上下移动只改变第idx(=列号)列，即转置棋盘的第idx行
+// 其余行/列与父棋盘移动后的结果相同
+template <int move>
+static inline float score_leaf_move(const heur_lines_t &m, board_t child, board_t child_t, row_t line, int idx,
+                                   bool &valid) {
+    const bool horiz = (move >= 2);
+    row_t newline = execute_move_line(move, line);
+    board_t lines = horiz ? m.rows : m.cols;
+    lines = (lines & ~(ROW_MASK << (16*idx))) | (board_t(newline) << (16*idx));
+    if (lines == (horiz ? child : child_t)) // 无效移动
+        return 0.0f;
+    valid = true;
+
+    // 变化的那一行在每条交叉线上只占第idx个nibble，一次64位运算即可更新全部4条交叉线
+    board_t cross = horiz ? m.cols : m.rows;
+    cross = (cross & ~(COL_MASK << (4*idx))) | (unpack_col(newline) << (4*idx));
+
+    float h = heur_score_table[newline];
+    const float *same = horiz ? m.row : m.col;
+    float s0 = (idx == 0) ? h : same[0];
+    float s1 = (idx == 1) ? h : same[1];
+    float s2 = (idx == 2) ? h : same[2];
+    float s3 = (idx == 3) ? h : same[3];
+    float c0 = heur_score_table[(cross >>  0) & ROW_MASK];
+    float c1 = heur_score_table[(cross >> 16) & ROW_MASK];
+    float c2 = heur_score_table[(cross >> 32) & ROW_MASK];
+    float c3 = heur_score_table[(cross >> 48) & ROW_MASK];
+    if (horiz)
+        return (s0 + s1 + s2 + s3) + (c0 + c1 + c2 + c3);
+    return (c0 + c1 + c2 + c3) + (s0 + s1 + s2 + s3);
+}
+
+// 增量评估叶子层的最大节点
+// 子节点为父棋盘在pos处放置tile后的棋盘，其所有移动结果都直接使用启发式评分，
+// 等价于score_move_node + 叶子处的score_tilechoose_node
+static float score_move_leaf(eval_state &state, const spawn_parent_t &p, board_t tile, int pos) {
+    int r = pos >> 2, c = pos & 3;
+    board_t child   = p.board | tile;
+    board_t child_t = p.trans | ((tile >> (4*pos)) << (4*(4*c + r))); // 转置后(r,c)位于(c,r)
+    row_t child_row = (child   >> (16*r)) & ROW_MASK;
+    row_t child_col = (child_t >> (16*c)) & ROW_MASK;
+
+    bool valid = false;
+    float s0 = score_leaf_move<0>(p.moved[0], child, child_t, child_col, c, valid);
+    float s1 = score_leaf_move<1>(p.moved[1], child, child_t, child_col, c, valid);
+    float s2 = score_leaf_move<2>(p.moved[2], child, child_t, child_row, r, valid);
+    float s3 = score_leaf_move<3>(p.moved[3], child, child_t, child_row, r, valid);
+    state.moves_evaled += 4;
+
+    // 有效移动都到达了叶子层
+    if (valid)
+        state.maxdepth = std::max(state.curdepth + 1, state.maxdepth);
+
+    float best = std::max(std::max(std::max(std::max(0.0f, s0), s1), s2), s3);
+    if (best == 0.0f) {
+        // 所有移动都无效或评分不大于0，与score_move_node一致返回子节点本身的启发式评分
+        return score_heur_board(child);
+    }
+    return best;
+}
+
+// 评估随机节点的一个子节点：若其后续随机节点全部为叶子，则走增量路径
+static inline float score_spawn_child(eval_state &state, spawn_parent_t &p, board_t tile, int pos, float cprob) {
+    if (cprob < CPROB_THRESH_BASE || state.curdepth + 1 >= state.depth_limit) {
+        if (!p.ready)
+            init_spawn_parent(p);
+        return score_move_leaf(state, p, tile, pos);
+    }
+    return score_move_node(state, p.board | tile, cprob);
+}
+
+/* 近似随机节点：分层抽样
+ * 将num_open个空格按顺序分成budget层，每层取一个空格，只展开被选中的空格。
+ * 被选中的空格上仍按0.9/0.1精确加权2和4，因此方差只来自空格位置的抽样。
+ * 偏移量由棋盘哈希得到，同一局面总是抽到相同的空格，便于缓存和复现。
+ * cprob为每个空格的真实概率，保证概率剪枝与完全展开时一致。
+ * 返回值的方差 = 抽样方差(有限总体修正) + 各样本子树方差按权重平方相加，写入state.node_var。
+ */
+static float score_tilechoose_sampled(eval_state &state, spawn_parent_t &parent, int num_open, int budget,
+                                      float cprob) {
+    float values[16];
+    float child_var = 0.0f;
+    double offset = double(((parent.board * 0x9E3779B97F4A7C15ULL) >> 40) & 0xffffff) / 16777216.0;
+    double stride = double(num_open) / budget;
+    int n = 0, open = 0, next = int(offset * stride);
+    board_t tmp = parent.board;
+    board_t tile_2 = 1;
+    int pos = 0;
+    while (tile_2 && n < budget) {
+        if ((tmp & 0xf) == 0) {
+            if (open == next) {
+                float v2 = score_spawn_child(state, parent,  tile_2      , pos, cprob * 0.9f);
+                child_var += take_node_var(state) * 0.81f;
+                float v4 = score_spawn_child(state, parent, (tile_2 << 1), pos, cprob * 0.1f);
+                child_var += take_node_var(state) * 0.01f;
+                values[n++] = v2 * 0.9f + v4 * 0.1f;
+                next = int((n + offset) * stride);
+            }
+            open++;
+        }
+        tmp >>= 4;
+        tile_2 <<= 4;
+        pos++;
+    }
+
+    float mean = 0.0f;
+    for (int i = 0; i < n; ++i)
+        mean += values[i];
+    mean /= n;
+
+    // 样本方差及有限总体修正后的均值方差
+    float var = 0.0f;
+    for (int i = 0; i < n; ++i)
+        var += (values[i] - mean) * (values[i] - mean);
+    if (n > 1)
+        var /= n - 1;
+
+    state.sampled_nodes++;
+    state.node_var = var / n * (1.0f - float(n) / num_open) + child_var / (float(n) * n);
+    return mean;
+}
 
 // 评估随机放置方块后的所有可能状态
 // 这是expectimax算法的随机节点，处理游戏的随机性(新方块的生成)
@@ -414,38 +929,75 @@ static float score_tilechoose_node(eval_state &state, board_t board, float cprob
             */
             if(entry.depth <= state.curdepth) {
                 state.cachehits++;
+                state.node_var = unpack_node_var(entry.variance);
                 return entry.heuristic; // 直接返回缓存的评分
             }
         }
+
+        // 私有置换表未命中时再查询跨进程共享置换表
+        float heuristic;
+        if (state.depth_limit - state.curdepth >= SHARED_TRANS_MIN_REMAINING &&
+            shared_trans_lookup(board, state.depth_limit - state.curdepth, cprob, heuristic)) {
+            state.sharedhits++;
+            trans_table_entry_t entry = {static_cast<uint8_t>(state.curdepth), 0, heuristic};
+            state.trans_table[board] = entry;
+            return heuristic;
+        }
     }
 
     // 计算空格数量并调整概率
     // 空格越多，每个空格被选中的概率越低
     int num_open = count_empty(board);
+    float node_cprob = cprob;
+    float var = 0.0f;
     cprob /= num_open; // 将当前概率平均分配给每个空格
 
+    spawn_parent_t parent;
+    parent.board = board;
+    parent.ready = false;
+
+    // 较深的随机节点在空格数超过预算时只抽样部分空格
+    int budget = state.curdepth < SAMPLE_MAX_DEPTH ? sample_budget[state.curdepth] : 0;
+    if (budget > 0 && budget < num_open) {
+        float res = score_tilechoose_sampled(state, parent, num_open, budget, cprob);
+        if (state.curdepth < CACHE_DEPTH_LIMIT)
+            trans_table_store(state, board, res, state.node_var);
+        return res;
+    }
+
     // 计算所有可能的新方块位置和值的平均得分
     float res = 0.0f;
     board_t tmp = board;
     board_t tile_2 = 1; // 表示值为2的方块(在内部编码中为1)
+    int pos = 0;
     while (tile_2) {
         if ((tmp & 0xf) == 0) { // 如果位置为空
             // 考虑放置2(90%概率)和4(10%概率)的情况
             // 对每种可能性计算后续移动的最佳分数，并按概率加权
-            res += score_move_node(state, board |  tile_2      , cprob * 0.9f) * 0.9f; // 放置2的情况
-            res += score_move_node(state, board | (tile_2 << 1), cprob * 0.1f) * 0.1f; // 放置4的情况
+            res += score_spawn_child(state, parent,  tile_2      , pos, cprob * 0.9f) * 0.9f; // 放置2的情况
+            if (state.approximate)
+                var += take_node_var(state) * 0.81f;
+            res += score_spawn_child(state, parent, (tile_2 << 1), pos, cprob * 0.1f) * 0.1f; // 放置4的情况
+            if (state.approximate)
+                var += take_node_var(state) * 0.01f;
         }
         tmp >>= 4;     // 检查下一个位置
         tile_2 <<= 4;  // 更新方块位置
+        pos++;
     }
     res = res / num_open; // 计算所有可能性的平均得分
+    var = var / (float(num_open) * num_open);
 
     // 将结果存入置换表，以便未来重用
     if (state.curdepth < CACHE_DEPTH_LIMIT) {
-        trans_table_entry_t entry = {static_cast<uint8_t>(state.curdepth), res};
-        state.trans_table[board] = entry;
+        trans_table_store(state, board, res, var);
+        // 启用抽样时，即使本节点完全展开，其子树也可能包含近似值，
+        // 因此整个评估都不写入共享置换表，避免影响完全展开的其他进程
+        if (!state.approximate && state.depth_limit - state.curdepth >= SHARED_TRANS_MIN_REMAINING)
+            shared_trans_store(board, state.depth_limit - state.curdepth, node_cprob, res, state.shared_age);
     }
 
+    state.node_var = var;
     return res;
 }
 
@@ -453,6 +1005,9 @@ static float score_tilechoose_node(eval_state &state, board_t board, float cprob
 // 这是expectimax算法的最大节点，选择玩家的最佳移动
 static float score_move_node(eval_state &state, board_t board, float cprob) {
     float best = 0.0f; // 记录最佳得分
+    // 最佳移动评分的方差(抽样时)，只沿决定本节点评分的子树传递；
+    // 噪声导致的选择偏差(取最大值偏高)不计入，因此实际误差通常更大
+    float best_var = 0.0f;
     state.curdepth++; // 增加搜索深度
     
     // 尝试四个方向的移动，选择得分最高的
@@ -464,7 +1019,11 @@ static float score_move_node(eval_state &state, board_t board, float cprob) {
             // 计算该移动后的最佳得分，通过递归调用随机节点
             // 这模拟了游戏的随机生成新方块过程
             float score = score_tilechoose_node(state, newboard, cprob);
-            best = std::max(best, score); // 更新最佳得分
+            float var = take_node_var(state);
+            if (score > best) { // 更新最佳得分
+                best = score;
+                best_var = var;
+            }
         }
     }
     state.curdepth--; // 回溯搜索深度
@@ -475,6 +1034,7 @@ static float score_move_node(eval_state &state, board_t board, float cprob) {
         return score_heur_board(board);
     }
 
+    state.node_var = best_var;
     return best;
 }
 
@@ -502,6 +1062,7 @@ float score_toplevel_move(board_t board, int move) {
     // 根据棋盘复杂度动态调整深度限制
     // 棋盘上不同数字越多，游戏状态越复杂，需要更深的搜索
     state.depth_limit = std::max(3, count_distinct_tiles(board) - 2);
+    state.approximate = sample_budget_active();
 
     // 记录开始时间
     gettimeofday(&start, NULL);
@@ -515,8 +1076,11 @@ float score_toplevel_move(board_t board, int move) {
     elapsed += (finish.tv_usec - start.tv_usec) / 1000000.0;
 
     // 打印详细的统计信息
-    printf("Move %d: result %f: eval'd %ld moves (%d cache hits, %d cache size) in %.2f seconds (maxdepth=%d)\n", move, res,
-        state.moves_evaled, state.cachehits, (int)state.trans_table.size(), elapsed, state.maxdepth);
+    printf("Move %d: result %f: eval'd %ld moves (%d cache hits, %d shared hits, %d cache size) in %.2f seconds (maxdepth=%d)\n", move, res,
+        state.moves_evaled, state.cachehits, state.sharedhits, (int)state.trans_table.size(), elapsed, state.maxdepth);
+    if (state.sampled_nodes)
+        printf("  sampled %d chance nodes, std. error %.1f (excluding max-node selection bias)\n",
+            state.sampled_nodes, sqrtf(state.node_var));
 
     return res;
 }
@@ -562,6 +1126,320 @@ int find_best_move(board_t board) {
     return bestmove; // 返回最佳移动方向
 }
 
+/**
+ * 逐层广度优先的Expectimax(可选引擎)
+ * -----------------------------
+ * 与score_toplevel_move的深度优先递归不同，这里一次展开一整层，每层节点存放在连续的数组中：
+ * 1. 展开：随机层的每个节点生成所有(空格, 2/4)子节点，最大层的每个节点生成四个方向的移动结果
+ * 2. 去重：对下一层的候选棋盘做基数排序并去重，同一局面在同一层只保留一份，到达概率取最大值
+ * 3. 评估：最后一层全部是叶子，不再去重，直接对连续数组批量计算启发式评分
+ * 4. 回溯：自底向上逐层计算，随机层按概率求期望，最大层取最大值
+ * 深度限制和概率剪枝与深度优先搜索一致。
+ * 展开(先统计子边数量再按前缀和并行填充)、基数排序、去重和回溯都按节点或块切分，
+ * 用-fopenmp编译时会并行执行。
+ */
+#if defined(_OPENMP)
+#define BFS_PARALLEL_FOR _Pragma("omp parallel for schedule(static)")
+#else
+#define BFS_PARALLEL_FOR
+#endif
+
+// 搜索树的一层，随机层与最大层交替出现
+struct bfs_level_t {
+    std::vector<board_t> boards;  // 本层去重后的棋盘(已排序；叶子层不去重)
+    std::vector<float> cprob;     // 合并后的最大到达概率
+    std::vector<uint32_t> first;  // 节点i的子边为[first[i], first[i+1])
+    std::vector<uint32_t> child;  // 子边指向的下一层节点下标
+    std::vector<float> weight;    // 子边的概率(仅随机层使用)
+    std::vector<float> value;     // 回溯得到的评分
+};
+
+// 展开时生成的候选子节点，edge为其在父层子边数组中的下标
+struct bfs_cand_t {
+    board_t board;
+    float cprob;
+    uint32_t edge;
+};
+
+static const long BFS_MAX_BLOCKS = 64;       // 排序/去重时最多切分的块数
+static const size_t BFS_MIN_BLOCK = 4096;    // 每块至少包含的候选数
+
+// 将n个候选切分为若干连续的块，各块可以并行处理
+static inline long bfs_num_blocks(size_t n) {
+    return std::max(1L, std::min(BFS_MAX_BLOCKS, long(n / BFS_MIN_BLOCK)));
+}
+
+static inline size_t bfs_block_begin(size_t n, long blocks, long blk) {
+    return n * blk / blocks;
+}
+
+// 按棋盘对候选节点做LSD基数排序(每趟8位)，所有候选在该字节上相同的趟直接跳过
+// 每趟先并行统计各块的直方图，再按(字节, 块)顺序计算偏移，最后各块并行分发，保持排序稳定
+static void bfs_radix_sort(std::vector<bfs_cand_t> &cand, std::vector<bfs_cand_t> &tmp) {
+    size_t n = cand.size();
+    if (n < 2)
+        return;
+    long blocks = bfs_num_blocks(n);
+    std::vector<board_t> block_diff(blocks);
+    std::vector<size_t> count(blocks * 256);
+
+    BFS_PARALLEL_FOR
+    for (long blk = 0; blk < blocks; ++blk) {
+        board_t diff = 0;
+        for (size_t i = bfs_block_begin(n, blocks, blk); i < bfs_block_begin(n, blocks, blk + 1); ++i)
+            diff |= cand[i].board ^ cand[0].board;
+        block_diff[blk] = diff;
+    }
+    board_t diff = 0;
+    for (long blk = 0; blk < blocks; ++blk)
+        diff |= block_diff[blk];
+
+    tmp.resize(n);
+    for (int shift = 0; shift < 64; shift += 8) {
+        if (((diff >> shift) & 0xff) == 0)
+            continue;
+
+        BFS_PARALLEL_FOR
+        for (long blk = 0; blk < blocks; ++blk) {
+            size_t *c = &count[blk * 256];
+            std::fill(c, c + 256, 0);
+            for (size_t i = bfs_block_begin(n, blocks, blk); i < bfs_block_begin(n, blocks, blk + 1); ++i)
+                c[(cand[i].board >> shift) & 0xff]++;
+        }
+
+        size_t sum = 0;
+        for (int b = 0; b < 256; ++b) {
+            for (long blk = 0; blk < blocks; ++blk) {
+                size_t c = count[blk * 256 + b];
+                count[blk * 256 + b] = sum;
+                sum += c;
+            }
+        }
+
+        BFS_PARALLEL_FOR
+        for (long blk = 0; blk < blocks; ++blk) {
+            size_t *c = &count[blk * 256];
+            for (size_t i = bfs_block_begin(n, blocks, blk); i < bfs_block_begin(n, blocks, blk + 1); ++i)
+                tmp[c[(cand[i].board >> shift) & 0xff]++] = cand[i];
+        }
+        cand.swap(tmp);
+    }
+}
+
+// 对候选节点排序去重作为下一层的节点，同时把父层每条子边指向去重后的下标
+// 先并行统计每块中新出现的棋盘数，前缀和得到各块的起始下标后再并行写出
+static void bfs_dedup(std::vector<bfs_cand_t> &cand, std::vector<bfs_cand_t> &tmp,
+                      bfs_level_t &next, std::vector<uint32_t> &child) {
+    bfs_radix_sort(cand, tmp);
+    size_t n = cand.size();
+    long blocks = bfs_num_blocks(n);
+    std::vector<size_t> heads(blocks + 1, 0);
+
+    BFS_PARALLEL_FOR
+    for (long blk = 0; blk < blocks; ++blk) {
+        size_t count = 0;
+        for (size_t i = bfs_block_begin(n, blocks, blk); i < bfs_block_begin(n, blocks, blk + 1); ++i)
+            count += (i == 0 || cand[i].board != cand[i - 1].board);
+        heads[blk + 1] = count;
+    }
+    for (long blk = 0; blk < blocks; ++blk)
+        heads[blk + 1] += heads[blk];
+
+    next.boards.resize(heads[blocks]);
+    next.cprob.resize(heads[blocks]);
+    child.resize(n);
+
+    BFS_PARALLEL_FOR
+    for (long blk = 0; blk < blocks; ++blk) {
+        // 块首若与前一块末尾是同一棋盘，沿用前一块的下标
+        long idx = long(heads[blk]) - 1;
+        for (size_t i = bfs_block_begin(n, blocks, blk); i < bfs_block_begin(n, blocks, blk + 1); ++i) {
+            if (i == 0 || cand[i].board != cand[i - 1].board) {
+                // 由每组重复棋盘的第一个负责合并到达概率(取最大值)
+                float cprob = cand[i].cprob;
+                for (size_t j = i + 1; j < n && cand[j].board == cand[i].board; ++j)
+                    cprob = std::max(cprob, cand[j].cprob);
+                idx++;
+                next.boards[idx] = cand[i].board;
+                next.cprob[idx] = cprob;
+            }
+            child[cand[i].edge] = idx;
+        }
+    }
+}
+
+int find_best_move_bfs(board_t board) {
+    struct timeval start, finish;
+    double elapsed;
+    int move;
+    float best = 0;
+    int bestmove = -1;
+
+    print_board(board);
+    printf("Current scores: heur %.0f, actual %.0f\n", score_heur_board(board), score_board(board));
+
+    gettimeofday(&start, NULL);
+
+    // 第2k层为深度k的随机节点，第2k+1层为其后的最大节点，第2*depth_limit层全部为叶子
+    int depth_limit = std::max(3, count_distinct_tiles(board) - 2);
+    std::vector<bfs_level_t> levels(2 * depth_limit + 1);
+    std::vector<bfs_cand_t> cand, tmp;
+    std::vector<uint32_t> root_child;
+    unsigned long generated = 0; // 去重前生成的节点总数
+    unsigned long unique = 0;    // 去重后的节点总数(叶子层不去重)
+
+    for (move = 0; move < 4; ++move) {
+        board_t newboard = execute_move(move, board);
+        if (newboard != board) {
+            bfs_cand_t c = {newboard, 1.0f, (uint32_t)cand.size()};
+            cand.push_back(c);
+        }
+    }
+    generated += cand.size();
+    bfs_dedup(cand, tmp, levels[0], root_child);
+    unique += levels[0].boards.size();
+
+    // 逐层展开
+    for (size_t d = 0; d + 1 < levels.size(); ++d) {
+        bfs_level_t &cur = levels[d];
+        bool chance = (d % 2 == 0);
+        long n = cur.boards.size();
+        std::vector<board_t> moved;   // 最大层：每个节点四个方向移动后的棋盘
+        if (!chance)
+            moved.resize(4 * n);
+        cur.first.resize(n + 1);
+        cur.first[0] = 0;
+
+        // 第一遍：并行统计每个节点的子边数量
+        BFS_PARALLEL_FOR
+        for (long i = 0; i < n; ++i) {
+            board_t b = cur.boards[i];
+            uint32_t count = 0;
+            if (chance) {
+                // 概率过小的随机节点不再展开，直接作为叶子
+                if (cur.cprob[i] >= CPROB_THRESH_BASE)
+                    count = 2 * count_empty(b);
+            } else {
+                for (int m = 0; m < 4; ++m) {
+                    moved[4 * i + m] = execute_move(m, b);
+                    count += (moved[4 * i + m] != b);
+                }
+            }
+            cur.first[i + 1] = count;
+        }
+        for (long i = 0; i < n; ++i)
+            cur.first[i + 1] += cur.first[i];
+
+        // 第二遍：每个节点写入自己的子边区间，可以并行
+        cand.resize(cur.first[n]);
+        if (chance)
+            cur.weight.resize(cur.first[n]);
+        BFS_PARALLEL_FOR
+        for (long i = 0; i < n; ++i) {
+            board_t b = cur.boards[i];
+            float cprob = cur.cprob[i];
+            uint32_t e = cur.first[i];
+            if (e == cur.first[i + 1])
+                continue;
+            if (chance) {
+                int num_open = count_empty(b);
+                float p2 = 0.9f / num_open;
+                float p4 = 0.1f / num_open;
+                board_t empty = b;
+                board_t tile_2 = 1;
+                while (tile_2) {
+                    if ((empty & 0xf) == 0) {
+                        bfs_cand_t c2 = {b |  tile_2      , cprob * p2, e};
+                        bfs_cand_t c4 = {b | (tile_2 << 1), cprob * p4, e + 1};
+                        cand[e] = c2;
+                        cand[e + 1] = c4;
+                        cur.weight[e] = p2;
+                        cur.weight[e + 1] = p4;
+                        e += 2;
+                    }
+                    empty >>= 4;
+                    tile_2 <<= 4;
+                }
+            } else {
+                for (int m = 0; m < 4; ++m) {
+                    if (moved[4 * i + m] != b) {
+                        bfs_cand_t c = {moved[4 * i + m], cprob, e};
+                        cand[e++] = c;
+                    }
+                }
+            }
+        }
+
+        generated += cand.size();
+        if (d + 2 < levels.size()) {
+            bfs_dedup(cand, tmp, levels[d + 1], cur.child);
+        } else {
+            // 叶子层只需一次查表评估，比排序去重更便宜，按子边顺序直接存放
+            bfs_level_t &next = levels[d + 1];
+            next.boards.resize(cand.size());
+            cur.child.resize(cand.size());
+            BFS_PARALLEL_FOR
+            for (long e = 0; e < (long)cand.size(); ++e) {
+                next.boards[e] = cand[e].board;
+                cur.child[e] = e;
+            }
+        }
+        unique += levels[d + 1].boards.size();
+    }
+
+    // 自底向上回溯；没有子节点的节点(叶子、概率剪枝或无法移动)使用启发式评分
+    for (long d = (long)levels.size() - 1; d >= 0; --d) {
+        bfs_level_t &cur = levels[d];
+        const bfs_level_t *next = (d + 1 < (long)levels.size()) ? &levels[d + 1] : NULL;
+        bool chance = (d % 2 == 0);
+        cur.value.resize(cur.boards.size());
+
+        BFS_PARALLEL_FOR
+        for (long i = 0; i < (long)cur.boards.size(); ++i) {
+            if (!next || cur.first[i] == cur.first[i + 1]) {
+                cur.value[i] = score_heur_board(cur.boards[i]);
+                continue;
+            }
+            float res = 0.0f;
+            for (uint32_t e = cur.first[i]; e < cur.first[i + 1]; ++e) {
+                float v = next->value[cur.child[e]];
+                if (chance)
+                    res += v * cur.weight[e];
+                else
+                    res = std::max(res, v);
+            }
+            // 与score_move_node一致：所有子节点评分都不大于0时使用本节点的启发式评分
+            if (!chance && res == 0.0f)
+                res = score_heur_board(cur.boards[i]);
+            cur.value[i] = res;
+        }
+
+        // 释放已回溯完成的下一层
+        if (next)
+            levels.pop_back();
+    }
+
+    for (move = 0; move < 4; ++move) {
+        board_t newboard = execute_move(move, board);
+        if (newboard == board)
+            continue;
+        uint32_t idx = std::lower_bound(levels[0].boards.begin(), levels[0].boards.end(), newboard) - levels[0].boards.begin();
+        float res = levels[0].value[idx] + 1e-6;
+        printf("Move %d: result %f\n", move, res);
+        if (res > best) {
+            best = res;
+            bestmove = move;
+        }
+    }
+
+    gettimeofday(&finish, NULL);
+    elapsed = (finish.tv_sec - start.tv_sec);
+    elapsed += (finish.tv_usec - start.tv_usec) / 1000000.0;
+    printf("BFS: %lu nodes after dedup (%lu generated) in %.2f seconds (depth=%d)\n", unique, generated, elapsed, depth_limit);
+
+    return bestmove;
+}
+
 // 询问用户输入移动方向
 int ask_for_move(board_t board) {
     int move;
@@ -599,14 +1477,26 @@ int ask_for_move(board_t board) {
 }
 
 /* 游戏逻辑 */
+// 对局使用的随机数状态：非0时为可复现的xorshift序列(批量对局)，否则使用平台的unif_random
+static uint64_t game_rng = 0;
+
+static unsigned game_random(unsigned n) {
+    if (!game_rng)
+        return unif_random(n);
+    game_rng ^= game_rng << 13;
+    game_rng ^= game_rng >> 7;
+    game_rng ^= game_rng << 17;
+    return (unsigned)((game_rng >> 32) % n);
+}
+
 // 随机生成一个方块(90%概率为2，10%概率为4)
 static board_t draw_tile() {
-    return (unif_random(10) < 9) ? 1 : 2;
+    return (game_random(10) < 9) ? 1 : 2;
 }
 
 // 在随机空位置放置一个方块
 static board_t insert_tile_rand(board_t board, board_t tile) {
-    int index = unif_random(count_empty(board));
+    int index = game_random(count_empty(board));
     board_t tmp = board;
     while (true) {
         while ((tmp & 0xf) != 0) { // 跳过非空位置
@@ -623,15 +1513,15 @@ static board_t insert_tile_rand(board_t board, board_t tile) {
 
 // 创建初始棋盘(随机放置两个方块)
 static board_t initial_board() {
-    board_t board = draw_tile() << (4 * unif_random(16));
+    board_t board = draw_tile() << (4 * game_random(16));
     return insert_tile_rand(board, draw_tile());
 }
 
-// 主游戏循环
-void play_game(get_move_func_t get_move) {
+// 主游戏循环：返回终局棋盘，moveno为走过的步数，scorepenalty为获得免费4方块的"惩罚"
+static board_t run_game(get_move_func_t get_move, int &moveno, int &scorepenalty) {
     board_t board = initial_board();
-    int moveno = 0;
-    int scorepenalty = 0; // 获得免费的4方块的"惩罚"
+    moveno = 0;
+    scorepenalty = 0;
 
     while(1) {
         int move;
@@ -666,14 +1556,101 @@ void play_game(get_move_func_t get_move) {
         board = insert_tile_rand(newboard, tile);
     }
 
+    return board;
+}
+
+void play_game(get_move_func_t get_move) {
+    int moveno, scorepenalty;
+    board_t board = run_game(get_move, moveno, scorepenalty);
+
     print_board(board);
     printf("\nGame over. Your score is %.0f. The highest rank you achieved was %d.\n", score_board(board) - scorepenalty, get_max_rank(board));
 }
 
+/**
+ * 批量对局
+ * -------
+ * 以相同的种子分别用完全展开和抽样(从sample_depth层起每个随机节点最多展开sample_cells个空格)
+ * 各下games局，在标准错误输出上打印每局结果和汇总(平均分、最大方块分布、每步用时)，
+ * 用于衡量抽样带来的棋力损失。逐步输出仍写到标准输出，可重定向到/dev/null。
+ */
+static void play_batch(int games, int sample_depth, int sample_cells) {
+    static const char *mode_names[2] = {"exhaustive", "sampled"};
+
+    for (int mode = 0; mode < 2; ++mode) {
+        for (int depth = 0; depth < SAMPLE_MAX_DEPTH; ++depth)
+            set_sample_budget(depth, (mode == 1 && depth >= sample_depth) ? sample_cells : 0);
+
+        double total_score = 0, total_secs = 0;
+        long total_moves = 0;
+        int rank_games[16] = {0}; // 最大方块恰为2^rank的局数
+
+        for (int game = 0; game < games; ++game) {
+            struct timeval start, finish;
+            int moveno, scorepenalty;
+
+            game_rng = 0x9E3779B97F4A7C15ULL * (game + 1); // 两种模式的第game局使用相同的种子
+            gettimeofday(&start, NULL);
+            board_t board = run_game(find_best_move, moveno, scorepenalty);
+            gettimeofday(&finish, NULL);
+
+            double elapsed = (finish.tv_sec - start.tv_sec) + (finish.tv_usec - start.tv_usec) / 1000000.0;
+            float score = score_board(board) - scorepenalty;
+            int rank = get_max_rank(board);
+            total_score += score;
+            total_secs += elapsed;
+            total_moves += moveno;
+            rank_games[rank & 0xf]++;
+            fprintf(stderr, "%s game %d: score %.0f, max tile %d, %d moves in %.1f seconds\n",
+                mode_names[mode], game, score, 1 << rank, moveno, elapsed);
+        }
+
+        fprintf(stderr, "%s: %d games, mean score %.0f, %.2f ms/move, max tile", mode_names[mode], games,
+            total_score / games, total_moves ? 1000.0 * total_secs / total_moves : 0.0);
+        for (int rank = 15; rank > 0; --rank) {
+            if (rank_games[rank])
+                fprintf(stderr, " %d:%d", 1 << rank, rank_games[rank]);
+        }
+        fprintf(stderr, "\n");
+    }
+
+    game_rng = 0;
+    for (int depth = 0; depth < SAMPLE_MAX_DEPTH; ++depth)
+        set_sample_budget(depth, 0);
+}
+
 // 主函数
 int main() {
     init_tables(); // 初始化各种查找表
-    play_game(find_best_move); // 使用AI玩游戏
+
+    // 设置环境变量AI2048_SHM_CACHE(如"/2048-ai")后，挂载同名共享内存段作为跨进程置换表
+    const char *shm_name = getenv("AI2048_SHM_CACHE");
+    if (shm_name && attach_shared_trans_table(shm_name, SHARED_TRANS_DEFAULT_MB) != 0)
+        printf("Failed to attach shared cache %s, using private cache only\n", shm_name);
+
+    // 设置环境变量AI2048_SAMPLE为"深度:空格数"(如"2:4")后，从该深度起的随机节点最多展开指定数量的空格
+    const char *sample = getenv("AI2048_SAMPLE");
+    int sample_depth = 2, sample_cells = 4;
+    bool sampling = sample && sscanf(sample, "%d:%d", &sample_depth, &sample_cells) == 2;
+
+    // 设置环境变量AI2048_BATCH=N后，用完全展开和抽样(AI2048_SAMPLE，默认"2:4")各下N局并汇总比较
+    const char *batch = getenv("AI2048_BATCH");
+    if (batch && atoi(batch) > 0) {
+        play_batch(atoi(batch), sample_depth, sample_cells);
+        return 0;
+    }
+
+    if (sampling) {
+        for (int depth = sample_depth; depth < SAMPLE_MAX_DEPTH; ++depth)
+            set_sample_budget(depth, sample_cells);
+    }
+
+    // 设置环境变量AI2048_ENGINE=bfs后使用逐层广度优先的搜索引擎
+    const char *engine = getenv("AI2048_ENGINE");
+    if (engine && strcmp(engine, "bfs") == 0)
+        play_game(find_best_move_bfs);
+    else
+        play_game(find_best_move); // 使用AI玩游戏
 }
 
 
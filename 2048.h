@@ -16,8 +16,10 @@ typedef uint64_t board_t;
 typedef uint16_t row_t;
 
 //store the depth at which the heuristic was recorded as well as the actual heuristic
+//variance is the sampling variance of the heuristic (upper 16 bits of a float), 0 when exhaustive
 struct trans_table_entry_t{
     uint8_t depth;
+    uint16_t variance;
     float heuristic;
 };
 
@@ -57,9 +59,26 @@ DLL_PUBLIC board_t execute_move(int move, board_t board);
 typedef int (*get_move_func_t)(board_t);
 DLL_PUBLIC float score_toplevel_move(board_t board, int move);
 DLL_PUBLIC int find_best_move(board_t board);
+DLL_PUBLIC int find_best_move_bfs(board_t board);
 DLL_PUBLIC int ask_for_move(board_t board);
 DLL_PUBLIC void play_game(get_move_func_t get_move);
 
+/* Cross-process transposition table in a named POSIX shared-memory segment.
+ * size_mb is only used when the segment is created; returns 0 on success.
+ * Call after init_tables(): an existing segment created with a different
+ * heuristic or entry format is refused (returns -1). */
+DLL_PUBLIC int attach_shared_trans_table(const char *name, unsigned size_mb);
+DLL_PUBLIC void detach_shared_trans_table();
+
+/* Approximate search: chance nodes at the given depth expand at most `cells`
+ * empty cells (stratified sample, at least 2); 0 restores exhaustive expansion.
+ * While any budget is set, results are not written to the shared table.
+ * score_toplevel_move then prints the standard error of the sampled result,
+ * propagated in quadrature along the moves that decide it. It ignores the
+ * upward bias of taking a max over noisy values and so understates the true
+ * error (by about 2x at depth 2, 4 cells). */
+DLL_PUBLIC void set_sample_budget(int depth, int cells);
+
 #ifdef __cplusplus
 }
 #endif